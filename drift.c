@@ -0,0 +1,102 @@
+
+#include <math.h>
+#include <string.h>
+
+#include "drift.h"
+
+
+// Weight of each new interval in the baseline, so it follows slow changes in
+// the stream without flagging them.
+#define BASELINE_WEIGHT (0.1)
+
+
+void drift_sample(Drift* drift, const char* buff, int len) {
+    const unsigned char* bytes = (const unsigned char*) buff;
+    int i;
+
+    if (len > DRIFT_SAMPLE_SIZE) {
+        len = DRIFT_SAMPLE_SIZE;
+    }
+
+    for (i=0; i + 3 < len; i += 4) {
+        ++drift->counts[0][bytes[i]];
+        ++drift->counts[1][bytes[i + 1]];
+        ++drift->counts[2][bytes[i + 2]];
+        ++drift->counts[3][bytes[i + 3]];
+    }
+    for (; i < len; ++i) {
+        ++drift->counts[0][bytes[i]];
+    }
+    drift->samples += len;
+}
+
+
+static double divergence(const double* p, const double* q) {
+    double score = 0;
+    int i;
+
+    // Jensen-Shannon: symmetric, fine with zeros, and between 0 & 1 bits.
+    for (i=0; i < 256; ++i) {
+        double m = (p[i] + q[i]) / 2;
+
+        if (p[i] > 0) {
+            score += p[i] * log2(p[i] / m);
+        }
+        if (q[i] > 0) {
+            score += q[i] * log2(q[i] / m);
+        }
+    }
+
+    return score / 2;
+}
+
+
+int drift_check(Drift* drift, unsigned long int offset, double threshold,
+                unsigned long long min_samples) {
+    double interval[256];
+    int changed = 0;
+    int i;
+
+    drift->score = -1;
+    if (drift->samples < min_samples) {
+        return 0;
+    }
+
+    for (i=0; i < 256; ++i) {
+        unsigned long long count = drift->counts[0][i] + drift->counts[1][i] +
+            drift->counts[2][i] + drift->counts[3][i];
+
+        interval[i] = (double) count / drift->samples;
+    }
+
+    if (drift->have_baseline) {
+        drift->score = divergence(interval, drift->baseline);
+        changed = drift->score >= threshold;
+    }
+
+    if (changed) {
+        drift->last_change_start = drift->interval_start;
+        drift->last_change_end = offset;
+        if (drift->num_changes < DRIFT_MAX_CHANGES) {
+            drift->change_starts[drift->num_changes] = drift->interval_start;
+            drift->change_ends[drift->num_changes] = offset;
+        }
+        ++drift->num_changes;
+    }
+
+    // After a change, what the stream is now is the new normal.
+    if (changed || !drift->have_baseline) {
+        memcpy(drift->baseline, interval, sizeof(interval));
+        drift->have_baseline = 1;
+    } else {
+        for (i=0; i < 256; ++i) {
+            drift->baseline[i] += BASELINE_WEIGHT * (interval[i] - drift->baseline[i]);
+        }
+    }
+
+    memset(drift->counts, 0, sizeof(drift->counts));
+    drift->samples = 0;
+    drift->interval_start = offset;
+
+    return changed;
+}
@@ -0,0 +1,53 @@
+
+#ifndef __DRIFT_H__
+#define __DRIFT_H__
+
+// Only the start of each block read is sampled, to keep this cheap enough to
+// leave on.
+#define DRIFT_SAMPLE_SIZE (128)
+
+// Intervals with fewer samples than this roll into the next, since small
+// samples are too noisy to compare. Without reports, intervals end as soon as
+// they have this many.
+#define DRIFT_MIN_SAMPLES (8 * 1024)
+
+// The last interval has nothing to roll into, so it's scored on fewer, though
+// not so few that noise alone gets near the default threshold.
+#define DRIFT_FINAL_MIN_SAMPLES (2 * 1024)
+
+#define DRIFT_MAX_CHANGES (16)
+
+// Default Jensen-Shannon divergence, in bits, between an interval's byte
+// distribution and the baseline that counts as a change.
+#define DRIFT_DEFAULT_THRESHOLD (0.1)
+
+typedef struct Drift {
+    // Bytes are spread over 4 tables, so a run of the same value doesn't
+    // serialize on one counter.
+    unsigned long long counts[4][256];
+    unsigned long long samples;
+    unsigned long int interval_start;
+
+    // Distribution of the stream so far, since the last change.
+    double baseline[256];
+    int have_baseline;
+
+    // Score of the last interval checked, or -1 if it didn't have enough
+    // samples to score.
+    double score;
+
+    // Stream offsets the changes happened between, the first few and the
+    // latest.
+    unsigned long int last_change_start;
+    unsigned long int last_change_end;
+    unsigned long long num_changes;
+    unsigned long int change_starts[DRIFT_MAX_CHANGES];
+    unsigned long int change_ends[DRIFT_MAX_CHANGES];
+} Drift;
+
+void drift_sample(Drift* drift, const char* buff, int len);
+
+int drift_check(Drift* drift, unsigned long int offset, double threshold,
+                unsigned long long min_samples);
+
+#endif
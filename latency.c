@@ -0,0 +1,108 @@
+
+#include <string.h>
+#include <time.h>
+
+#include "latency.h"
+
+
+unsigned long long monotonic_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+}
+
+
+void latency_reset(LatencyHist* hist) {
+    memset(hist, 0, sizeof(LatencyHist));
+}
+
+
+static int bucket_index(unsigned long long ns) {
+    int shift;
+
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int) ns;
+    }
+
+    // Keep the top 4 bits of the value: the leading 1 picks the power of 2,
+    // the 3 after it pick the sub bucket.
+    shift = 63 - __builtin_clzll(ns) - 3;
+    return (shift + 1) * LATENCY_SUB_BUCKETS +
+        (int) ((ns >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+
+static unsigned long long bucket_value(int index) {
+    int shift;
+    unsigned long long low;
+
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+
+    // Middle of the bucket's range.
+    shift = index / LATENCY_SUB_BUCKETS - 1;
+    low = (unsigned long long) (LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+
+void latency_record(LatencyHist* hist, unsigned long long ns) {
+    ++hist->buckets[bucket_index(ns)];
+    ++hist->count;
+
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+}
+
+
+unsigned long long latency_percentile(const LatencyHist* hist, double percent) {
+    unsigned long long target;
+    unsigned long long seen = 0;
+    int i;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    target = (unsigned long long) (hist->count * percent / 100.0);
+    if (target >= hist->count) {
+        return hist->max_ns;
+    }
+
+    for (i=0; i < LATENCY_BUCKETS; ++i) {
+        seen += hist->buckets[i];
+        if (seen > target) {
+            unsigned long long value = bucket_value(i);
+            return value < hist->max_ns ? value : hist->max_ns;
+        }
+    }
+
+    return hist->max_ns;
+}
+
+
+double adjust_latency(double ns) {
+    if (ns >= 1000 * 1000 * 1000) {
+        return ns / (1000 * 1000 * 1000);
+    } else if (ns >= 1000 * 1000) {
+        return ns / (1000 * 1000);
+    } else if (ns >= 1000) {
+        return ns / 1000;
+    }
+    return ns;
+}
+
+
+const char* latency_unit(double ns) {
+    if (ns >= 1000 * 1000 * 1000) {
+        return "s";
+    } else if (ns >= 1000 * 1000) {
+        return "ms";
+    } else if (ns >= 1000) {
+        return "us";
+    }
+    return "ns";
+}
@@ -0,0 +1,27 @@
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+// Log-linear buckets: 8 per power of 2, so each is within 12.5% of its value.
+#define LATENCY_SUB_BUCKETS (8)
+#define LATENCY_BUCKETS (62 * LATENCY_SUB_BUCKETS)
+
+typedef struct LatencyHist {
+    unsigned long long buckets[LATENCY_BUCKETS];
+    unsigned long long count;
+    unsigned long long max_ns;
+} LatencyHist;
+
+unsigned long long monotonic_ns();
+
+void latency_reset(LatencyHist* hist);
+
+void latency_record(LatencyHist* hist, unsigned long long ns);
+
+unsigned long long latency_percentile(const LatencyHist* hist, double percent);
+
+double adjust_latency(double ns);
+
+const char* latency_unit(double ns);
+
+#endif
@@ -0,0 +1,277 @@
+#!/bin/bash
+#
+# Throughput regression benchmark, run with `make bench`.
+#
+# Runs pipestats, and cat & splice_copy as baselines, over a matrix of
+# scenarios, recording G/s, CPU secs per G and read/write syscalls per G for each to
+# $BENCH_RESULTS. If there's a $BENCH_BASELINE from an earlier run (save one
+# with `make bench-baseline`), any result more than $BENCH_THRESHOLD percent
+# worse than it, or missing, is flagged, and the exit status is 1.
+
+set -u
+set -o pipefail
+
+BYTES=${BENCH_BYTES:-1073741824}
+FILE_BYTES=${BENCH_FILE_BYTES:-268435456}
+RUN_SECS=${BENCH_SECONDS:-2}
+RUNS=${BENCH_RUNS:-3}
+THRESHOLD=${BENCH_THRESHOLD:-10}
+RESULTS=${BENCH_RESULTS:-bench_results.tsv}
+BASELINE=${BENCH_BASELINE:-bench_baseline.tsv}
+
+BIN=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/pipestats_bench.XXXXXX") || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+TOOLS=(cat splice pipestats pipestats-f0.5 pipestats-f0 pipestats-counts)
+SCENARIOS=(zero-null pipe-pipe file-file slow-consumer bursty-producer)
+# These go at the pace of a replayed trace, so every tool gets the same G/s and
+# only CPU & syscalls tell them apart.
+PACED="slow-consumer bursty-producer"
+
+
+tool_cmd() {
+    case $1 in
+    cat)              echo "cat" ;;
+    splice)           echo "$BIN/splice_copy" ;;
+    pipestats)        echo "$BIN/pipestats" ;;
+    pipestats-f0.5)   echo "$BIN/pipestats -f 0.5" ;;
+    pipestats-f0)     echo "$BIN/pipestats -f 0" ;;
+    pipestats-counts) echo "$BIN/pipestats --counts" ;;
+    esac
+}
+
+
+# Shapes come from a trace of 1M bursts, 30ms apart. Replaying its reads makes
+# a bursty producer, and replaying its writes a slow consumer. It's written
+# out directly rather than recorded, so it doesn't depend on the pipestats
+# being measured.
+make_shape() {
+    SHAPE_BYTES=$((32 * 1048576))
+    "$BIN/replay_trace" bursts "$WORK/shape.trace" 32 1048576 30
+}
+
+
+# How many bytes made it out the other end, going by what the consumer said.
+sink_bytes() {
+    sed -n -e 's/^\([0-9][0-9]*\) bytes$/\1/p' \
+           -e 's/^Replayed .* events, \([0-9][0-9]*\) bytes .*/\1/p' "$1"
+}
+
+
+# Run one scenario with one tool, leaving bench_run's line in $WORK/run, the
+# tool's stderr in $WORK/stderr, and how many bytes it actually moved in
+# $WORK/moved. Echoes the number of bytes it should've moved, if the scenario
+# decides that up front, and fails if anything in it did.
+run_scenario() {
+    local scenario=$1
+    local cmd=$2
+    local run="$BIN/bench_run -o $WORK/run"
+    local err
+
+    # The producers reuse their buffers, so they aren't what's being measured.
+    # That's only safe because nothing looks at what comes out, just how much.
+    rm -f "$WORK/run" "$WORK/moved" "$WORK/sink"
+    case $scenario in
+    zero-null)
+        # Timed, so there's no telling how much should move. Take
+        # splice_copy's word for how much did, since splices aren't counted
+        # as reads, else the reads.
+        $run -t "$RUN_SECS" $cmd < /dev/zero > /dev/null 2> "$WORK/stderr"
+        err=$?
+        sink_bytes "$WORK/stderr" > "$WORK/moved"
+        [ -s "$WORK/moved" ] || awk '{ print $4 }' "$WORK/run" > "$WORK/moved" 2> /dev/null
+        ;;
+    pipe-pipe)
+        "$BIN/sequential_bytes" --reuse write $((BYTES / 4)) 2> /dev/null |
+            $run $cmd 2> "$WORK/stderr" |
+            "$BIN/splice_copy" > /dev/null 2> "$WORK/sink"
+        err=$?
+        sink_bytes "$WORK/sink" > "$WORK/moved"
+        echo "$BYTES"
+        ;;
+    file-file)
+        $run $cmd < "$WORK/input" > "$WORK/output" 2> "$WORK/stderr"
+        err=$?
+        wc -c < "$WORK/output" | tr -d ' ' > "$WORK/moved"
+        echo "$FILE_BYTES"
+        ;;
+    slow-consumer)
+        "$BIN/sequential_bytes" --reuse write $((SHAPE_BYTES / 4)) 2> /dev/null |
+            $run $cmd 2> "$WORK/stderr" |
+            "$BIN/replay_trace" consume "$WORK/shape.trace" 2> "$WORK/sink"
+        err=$?
+        sink_bytes "$WORK/sink" > "$WORK/moved"
+        echo "$SHAPE_BYTES"
+        ;;
+    bursty-producer)
+        "$BIN/replay_trace" produce "$WORK/shape.trace" 2> /dev/null |
+            $run $cmd 2> "$WORK/stderr" |
+            "$BIN/splice_copy" > /dev/null 2> "$WORK/sink"
+        err=$?
+        sink_bytes "$WORK/sink" > "$WORK/moved"
+        echo "$SHAPE_BYTES"
+        ;;
+    esac
+
+    return $err
+}
+
+
+# Relay a stream over loopback as several connections in a row, through a
+# relay that listens & connects, into one that listens, and check it all comes
+# out the other end in order. Not timed, just has to work.
+check_relay() {
+    local port=$((20000 + RANDOM % 20000))
+    local conns=4
+    local conn_nums=1048576
+    local total=$((conns * conn_nums * 4))
+    local out_pid
+    local mid_pid
+    local err=0
+    local i
+
+    "$BIN/pipestats" -f 0 -L $((port + 1)) > "$WORK/relayed" 2> "$WORK/relay_out" &
+    out_pid=$!
+    "$BIN/pipestats" -f 0 -L $port -C "localhost:$((port + 1))" > /dev/null 2> "$WORK/relay_mid" &
+    mid_pid=$!
+    sleep 0.2
+
+    "$BIN/sequential_bytes" write $((conns * conn_nums)) 2> /dev/null |
+        for i in $(seq $conns); do
+            head -c $((conn_nums * 4)) |
+                "$BIN/pipestats" -f 0 -C "localhost:$port" 2> /dev/null || exit 1
+        done || err=1
+
+    # The last connection can still be on its way through the relays.
+    for i in $(seq 50); do
+        [ "$(wc -c < "$WORK/relayed")" -ge $total ] && break
+        sleep 0.1
+    done
+    kill -INT $mid_pid $out_pid 2> /dev/null
+    wait $mid_pid $out_pid
+
+    if [ $err -ne 0 ] ||
+            ! "$BIN/sequential_bytes" read $((total / 4)) < "$WORK/relayed" 2> "$WORK/relay_check"; then
+        echo "Relaying $conns connections over loopback failed:" >&2
+        cat "$WORK/relay_check" "$WORK/relay_mid" "$WORK/relay_out" >&2 2> /dev/null
+        return 1
+    fi
+    rm -f "$WORK/relayed"
+}
+
+
+# Best of $RUNS for one scenario & tool, as a results row. That's the fastest,
+# or for a paced scenario, the one that took the least CPU.
+measure() {
+    local scenario=$1
+    local tool=$2
+    local cmd
+    local expected
+    local bytes
+    local best="-k5,5gr"
+    local i
+
+    case " $PACED " in
+    *" $scenario "*) best="-k6,6g" ;;
+    esac
+
+    cmd=$(tool_cmd "$tool")
+    rm -f "$WORK/rows"
+    for i in $(seq "$RUNS"); do
+        if ! expected=$(run_scenario "$scenario" "$cmd") || [ ! -s "$WORK/run" ]; then
+            echo "$scenario with $tool failed:" >&2
+            cat "$WORK/stderr" "$WORK/sink" >&2 2> /dev/null
+            return 1
+        fi
+
+        bytes=$(cat "$WORK/moved")
+        if [ -z "$bytes" ] || [ "$bytes" -eq 0 ] ||
+                { [ -n "$expected" ] && [ "$bytes" -ne "$expected" ]; }; then
+            echo "$scenario with $tool moved ${bytes:-no} bytes" \
+                 "instead of ${expected:-some}" >&2
+            return 1
+        fi
+
+        awk -v scenario="$scenario" -v tool="$tool" -v bytes="$bytes" '{
+            g = bytes / (1024 * 1024 * 1024)
+            printf "%s\t%s\t%.0f\t%.3f\t%.3f\t%.3f\t%.0f\n",
+                scenario, tool, bytes, $1, g / $1, ($2 + $3) / g, $5 / g
+        }' "$WORK/run" >> "$WORK/rows"
+    done
+    sort -t "$(printf '\t')" $best "$WORK/rows" | head -n 1
+}
+
+
+"$BIN/sequential_bytes" write $((FILE_BYTES / 4)) > "$WORK/input" 2> /dev/null || exit 1
+make_shape || exit 1
+check_relay || exit 1
+
+# Only read & write style syscalls are counted, since that's all the kernel
+# keeps track of per process. Splices, selects and the like aren't.
+printf "scenario\ttool\tbytes\tsecs\tG/s\tcpu_secs_per_G\trw_syscalls_per_G\n" > "$RESULTS"
+for scenario in "${SCENARIOS[@]}"; do
+    for tool in "${TOOLS[@]}"; do
+        measure "$scenario" "$tool" >> "$RESULTS" || exit 1
+    done
+done
+rm -f "$WORK/input" "$WORK/output"
+
+column -t -s "$(printf '\t')" "$RESULTS" 2> /dev/null || cat "$RESULTS"
+echo "Results in $RESULTS"
+
+if [ "${1:-}" = "--save-baseline" ]; then
+    cp "$RESULTS" "$BASELINE"
+    echo "Saved as baseline $BASELINE"
+    exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+    echo "No baseline to compare to, save one with \`make bench-baseline\`."
+    exit 0
+fi
+
+# Slower, more CPU per G, or more syscalls than the baseline by more than the
+# threshold are all regressions, and so is anything in the baseline that didn't
+# get measured this time. Paced scenarios can't get slower, only costlier.
+awk -F '\t' -v threshold="$THRESHOLD" -v paced="$PACED" '
+    BEGIN {
+        n = split(paced, names, " ")
+        for (i = 1; i <= n; ++i) {
+            is_paced[names[i]] = 1
+        }
+    }
+    FNR == 1 { next }
+    NR == FNR { gbps[$1 FS $2] = $5; cpu[$1 FS $2] = $6; calls[$1 FS $2] = $7; next }
+    !(($1 FS $2) in gbps) { next }
+    {
+        key = $1 FS $2
+        measured[key] = 1
+        worse = 1 + threshold / 100
+        if (!($1 in is_paced) && $5 * worse < gbps[key]) {
+            printf "REGRESSION %s %s: %.3f G/s, was %.3f\n", $1, $2, $5, gbps[key]
+            failed = 1
+        }
+        if ($6 > cpu[key] * worse) {
+            printf "REGRESSION %s %s: %.3f CPU secs per G, was %.3f\n", $1, $2, $6, cpu[key]
+            failed = 1
+        }
+        if ($7 > calls[key] * worse) {
+            printf "REGRESSION %s %s: %.0f read/write syscalls per G, was %.0f\n", $1, $2, $7, calls[key]
+            failed = 1
+        }
+    }
+    END {
+        for (key in gbps) {
+            if (!(key in measured)) {
+                split(key, names, FS)
+                printf "MISSING %s %s: in the baseline, but not measured\n", names[1], names[2]
+                failed = 1
+            }
+        }
+        if (!failed) {
+            printf "No regressions beyond %s%% of baseline.\n", threshold
+        }
+        exit failed
+    }
+' "$BASELINE" "$RESULTS"
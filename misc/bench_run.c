@@ -0,0 +1,161 @@
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+
+static volatile sig_atomic_t child_pid = 0;
+
+
+void stop_child(int signal) {
+    // SIGINT, so pipestats still gets to wrap up and report.
+    if (child_pid > 0) {
+        kill(child_pid, SIGINT);
+    }
+}
+
+
+double monotonic_sec() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / (1000.0 * 1000 * 1000);
+}
+
+
+// Read a field out of /proc/PID/io, which sticks around until the child's
+// reaped, so counts include everything up to its exit.
+unsigned long long proc_io(const char* io, const char* field) {
+    const char* found = strstr(io, field);
+
+    if (!found) {
+        return 0;
+    }
+    return strtoull(found + strlen(field), NULL, 10);
+}
+
+
+void print_usage(char** argv) {
+    fprintf(stderr,
+            "usage: %s [-t seconds] [-o file] command [args...]\n"
+            "\n"
+            "Runs command, and when it exits, writes a line of\n"
+            "    wall_secs user_secs sys_secs read_bytes rw_syscalls\n"
+            "to file (or stderr). read_bytes & rw_syscalls only count read/write\n"
+            "style calls, not splices, selects or any others.\n"
+            "\n"
+            "    -t seconds   Interrupt the command after this long.\n"
+            "    -o file      Where to write the results.\n",
+            argv[0]);
+}
+
+
+int main(int argc, char** argv) {
+    struct sigaction stop_action;
+    struct rusage usage;
+    siginfo_t info;
+    FILE* out = stderr;
+    FILE* io_file;
+    char io[1024];
+    char io_path[64];
+    size_t io_len = 0;
+    double seconds = 0;
+    double start;
+    double wall;
+    int status;
+    int opt;
+
+    // Stop at the first non-option, which is the command.
+    while ((opt = getopt(argc, argv, "+t:o:")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = strtod(optarg, NULL);
+            break;
+
+        case 'o':
+            if ((out = fopen(optarg, "a")) == NULL) {
+                fprintf(stderr, "Failed to open %s, err %d: %s\n",
+                        optarg, errno, strerror(errno));
+                return 1;
+            }
+            break;
+
+        default:
+            print_usage(argv);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        print_usage(argv);
+        return 1;
+    }
+
+    start = monotonic_sec();
+    if ((child_pid = fork()) == 0) {
+        execvp(argv[optind], argv + optind);
+        fprintf(stderr, "Failed to run %s, err %d: %s\n",
+                argv[optind], errno, strerror(errno));
+        _exit(127);
+    } else if (child_pid < 0) {
+        fprintf(stderr, "Failed to fork, err %d: %s\n", errno, strerror(errno));
+        return 1;
+    }
+
+    if (seconds > 0) {
+        struct itimerval timer;
+
+        memset(&stop_action, 0, sizeof(struct sigaction));
+        stop_action.sa_handler = &stop_child;
+        sigaction(SIGALRM, &stop_action, NULL);
+
+        memset(&timer, 0, sizeof(timer));
+        timer.it_value.tv_sec = (int) seconds;
+        timer.it_value.tv_usec = (seconds - (int) seconds) * (1000 * 1000);
+        setitimer(ITIMER_REAL, &timer, NULL);
+    }
+
+    // Wait for it to exit, but leave it around to read its io counts.
+    while (waitid(P_PID, child_pid, &info, WEXITED | WNOWAIT) != 0) {
+        if (errno != EINTR) {
+            fprintf(stderr, "Failed to wait for command, err %d: %s\n",
+                    errno, strerror(errno));
+            return 1;
+        }
+    }
+    wall = monotonic_sec() - start;
+
+    snprintf(io_path, sizeof(io_path), "/proc/%d/io", (int) child_pid);
+    if ((io_file = fopen(io_path, "r")) != NULL) {
+        io_len = fread(io, 1, sizeof(io) - 1, io_file);
+        fclose(io_file);
+    }
+    io[io_len] = '\0';
+
+    wait4(child_pid, &status, 0, &usage);
+
+    fprintf(out, "%.6f %.6f %.6f %llu %llu\n",
+            wall,
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / (1000.0 * 1000),
+            usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / (1000.0 * 1000),
+            proc_io(io, "rchar:"),
+            proc_io(io, "syscr:") + proc_io(io, "syscw:"));
+    fclose(out);
+
+    // Being interrupted on purpose isn't a failure.
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return seconds > 0 && WTERMSIG(status) == SIGINT ? 0 : 128 + WTERMSIG(status);
+}
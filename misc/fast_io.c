@@ -0,0 +1,153 @@
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include "fast_io.h"
+
+
+int fast_out_init(FastOut* out, int reuse) {
+    int pipe_size;
+    int i;
+
+    memset(out, 0, sizeof(FastOut));
+    out->reuse = reuse;
+    out->buff_size = FAST_IO_SIZE;
+
+    // The pipe might not grow as big as asked, or might already be bigger,
+    // so go with whatever it ends up as.
+    fcntl(STDOUT_FILENO, F_SETPIPE_SZ, FAST_IO_SIZE);
+    if ((pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ)) > 0) {
+        out->use_vmsplice = 1;
+        out->buff_size = pipe_size;
+    }
+
+    // Gifted buffers get mapped one at a time, as they're needed.
+    if (out->use_vmsplice && !out->reuse) {
+        return 0;
+    }
+
+    for (i=0; i < 2; ++i) {
+        // Page aligned, so each page of a buffer takes exactly one pipe slot.
+        if (posix_memalign((void**) &out->buffs[i], sysconf(_SC_PAGESIZE),
+                           out->buff_size) != 0) {
+            fprintf(stderr, "Failed to allocate %zu byte buffer.\n",
+                    out->buff_size);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+char* fast_out_buffer(FastOut* out) {
+    if (out->buffs[out->next] == NULL) {
+        void* buff = mmap(NULL, out->buff_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (buff == MAP_FAILED) {
+            fprintf(stderr, "Failed to map %zu byte buffer, err %d: %s\n",
+                    out->buff_size, errno, strerror(errno));
+            return NULL;
+        }
+        out->buffs[out->next] = buff;
+    }
+
+    return out->buffs[out->next];
+}
+
+
+int fast_out_write(FastOut* out, size_t len) {
+    struct iovec iov;
+
+    iov.iov_base = out->buffs[out->next];
+    iov.iov_len = len;
+    if (out->reuse) {
+        out->next = !out->next;
+    }
+
+    while (iov.iov_len > 0) {
+        ssize_t written;
+
+        if (out->use_vmsplice) {
+            written = vmsplice(STDOUT_FILENO, &iov, 1,
+                               out->reuse ? 0 : SPLICE_F_GIFT);
+            if (written < 0 && errno == EINVAL) {
+                // Not something that can take spliced pages after all.
+                out->use_vmsplice = 0;
+                continue;
+            }
+        } else {
+            written = write(STDOUT_FILENO, iov.iov_base, iov.iov_len);
+        }
+
+        if (written < 0) {
+            switch (errno) {
+            case EINTR:
+            case EBUSY:
+            case EDEADLK:
+            case EAGAIN:
+            case ETXTBSY:
+                break;
+
+            default:
+                fprintf(stderr, "Failed to write, err %d: %s\n",
+                        errno, strerror(errno));
+                return -1;
+                break;
+            }
+        } else {
+            iov.iov_base = (char*) iov.iov_base + written;
+            iov.iov_len -= written;
+        }
+    }
+
+    // The pipe holds its own references to gifted pages, so let go of ours
+    // and map a fresh buffer next time rather than write over them.
+    if (out->use_vmsplice && !out->reuse) {
+        munmap(out->buffs[out->next], out->buff_size);
+        out->buffs[out->next] = NULL;
+    }
+
+    return 0;
+}
+
+
+long long fast_in_read(char* buff, size_t len) {
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t bytes = read(STDIN_FILENO, buff + got, len - got);
+
+        if (bytes == 0) {
+            break;
+        } else if (bytes < 0) {
+            switch (errno) {
+            case EINTR:
+            case EBUSY:
+            case EDEADLK:
+            case EAGAIN:
+            case ETXTBSY:
+                break;
+
+            default:
+                fprintf(stderr, "Failed to read, err %d: %s\n",
+                        errno, strerror(errno));
+                return -1;
+                break;
+            }
+        } else {
+            got += bytes;
+        }
+    }
+
+    return got;
+}
@@ -0,0 +1,35 @@
+
+#ifndef __FAST_IO_H__
+#define __FAST_IO_H__
+
+#include <stddef.h>
+
+// Biggest pipe an unprivileged process gets by default.
+#define FAST_IO_SIZE (1024 * 1024)
+
+// Writes whole buffers to stdout. If stdout is a pipe, buffers the size of the
+// pipe are vmspliced into it instead of copied. By default each one is freshly
+// mapped and gifted to the pipe, then never touched again, so the data stays
+// put even if the reader splices the pages along somewhere else.
+//
+// With reuse set, it alternates between two buffers instead: once one's fully
+// in the pipe, the other must have been read out, so it's refilled. That saves
+// faulting in new pages, but only holds if the reader copies out of the pipe.
+typedef struct FastOut {
+    int use_vmsplice;
+    int reuse;
+    size_t buff_size;
+    char* buffs[2];
+    int next;
+} FastOut;
+
+int fast_out_init(FastOut* out, int reuse);
+
+char* fast_out_buffer(FastOut* out);
+
+int fast_out_write(FastOut* out, size_t len);
+
+// Reads up to len bytes from stdin, only returning less at the end of input.
+long long fast_in_read(char* buff, size_t len);
+
+#endif
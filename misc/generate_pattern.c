@@ -1,61 +1,194 @@
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "fast_io.h"
 
-#define BUFF_SIZE (8192)
+#define MAX_CHUNK_SIZE (FAST_IO_SIZE)
 
 
 #define PICK_CHAR(choices, num) ( choices[num % (sizeof(choices) / sizeof(choices[0]))] )
 
 
+static const char prefixes[] = {'<', '{', '('};
+static const char suffixes[] = {'>', '}', ')'};
+static const char extras[] = {'-', '=', '~', '#', '$'};
+
+
+void make_chunk(char* chunk, int chunk_size, long long chunk_num) {
+    int num_nums_in_chunk = (int) ((chunk_size - 2) / sizeof(int));
+    int num = (int) chunk_num;
+    int i;
+
+    // A chunk is bookended by <>, and in the middle, as many chunk_nums
+    // as can fit, as integers, and leftover space is filled with different
+    // things every chunk (so you can see if the same chunk's repeated on
+    // partial writes).
+    chunk[0] = PICK_CHAR(prefixes, chunk_num);
+    for (i=0; i < num_nums_in_chunk; ++i) {
+        memcpy(chunk + 1 + sizeof(int) * i, &num, sizeof(int));
+    }
+    memset(chunk + 1 + sizeof(int) * num_nums_in_chunk,
+           PICK_CHAR(extras, chunk_num),
+           chunk_size - 2 - sizeof(int) * num_nums_in_chunk);
+    chunk[chunk_size - 1] = PICK_CHAR(suffixes, chunk_num);
+}
+
+
+// Fill len bytes of the stream of chunks, starting at byte offset.
+void fill_pattern(char* buff, size_t len, long long offset, int chunk_size) {
+    static char partial[MAX_CHUNK_SIZE];
+    size_t filled = 0;
+
+    while (filled < len) {
+        long long chunk_num = (offset + filled) / chunk_size;
+        int chunk_offset = (offset + filled) % chunk_size;
+        size_t amount = chunk_size - chunk_offset;
+
+        if (amount > len - filled) {
+            amount = len - filled;
+        }
+
+        // Build chunks right in place, unless they straddle a buffer edge.
+        if (amount == chunk_size) {
+            make_chunk(buff + filled, chunk_size, chunk_num);
+        } else {
+            make_chunk(partial, chunk_size, chunk_num);
+            memcpy(buff + filled, partial + chunk_offset, amount);
+        }
+        filled += amount;
+    }
+}
+
+
+int generate(int chunk_size, long long num_chunks, int reuse) {
+    FastOut out;
+    long long total = num_chunks * chunk_size;
+    long long offset = 0;
+
+    if (fast_out_init(&out, reuse) != 0) {
+        return 1;
+    }
+
+    while (offset < total) {
+        char* buff = fast_out_buffer(&out);
+        size_t len = out.buff_size;
+
+        if (buff == NULL) {
+            return 1;
+        }
+        if (len > total - offset) {
+            len = total - offset;
+        }
+
+        fill_pattern(buff, len, offset, chunk_size);
+        if (fast_out_write(&out, len) != 0) {
+            return 1;
+        }
+        offset += len;
+    }
+
+    return 0;
+}
+
+
+int verify(int chunk_size, long long num_chunks) {
+    static char buff[FAST_IO_SIZE];
+    static char expected[FAST_IO_SIZE];
+    long long total = num_chunks * chunk_size;
+    long long offset = 0;
+
+    while (offset < total) {
+        long long len = sizeof(buff);
+        long long got;
+
+        if (len > total - offset) {
+            len = total - offset;
+        }
+
+        if ((got = fast_in_read(buff, len)) < 0) {
+            return 1;
+        }
+
+        fill_pattern(expected, got, offset, chunk_size);
+        if (memcmp(buff, expected, got) != 0) {
+            long long i;
+            long long chunk_num;
+            int found;
+
+            for (i=0; buff[i] == expected[i]; ++i) {
+            }
+            chunk_num = (offset + i) / chunk_size;
+
+            fprintf(stderr, "Mismatch at byte %lld, in chunk %lld.\n",
+                    offset + i, chunk_num);
+
+            // If a whole chunk made it in, say which one it was.
+            i -= (offset + i) % chunk_size;
+            if (chunk_size >= sizeof(int) + 2 && i >= 0 && i + 1 + sizeof(int) <= got) {
+                memcpy(&found, buff + i + 1, sizeof(int));
+                fprintf(stderr, "Found chunk %d there instead (%s).\n",
+                        found, found < (int) chunk_num ? "repeated data" : "skipped data");
+            }
+            return 1;
+        }
+
+        offset += got;
+        if (got < len) {
+            fprintf(stderr, "Ran out of input prematurely, after %lld bytes.\n", offset);
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "Read %lld chunks of %d bytes.\n", num_chunks, chunk_size);
+
+    return 0;
+}
+
+
 int main(int argc, char** argv) {
     int chunk_size;
-    int num_chunks;
-    int chunk_num;
-    int num_nums_in_chunk;
-    int leftover_in_chunk;
-    static const char prefixes[] = {'<', '{', '('};
-    static const char suffixes[] = {'>', '}', ')'};
-    static const char extras[] = {'-', '=', '~', '#', '$'};
+    long long num_chunks;
+    int reading = 0;
+    int reuse = 0;
+
+    if (argc > 1 && strcmp(argv[1], "--reuse") == 0) {
+        reuse = 1;
+        ++argv;
+        --argc;
+    }
+
+    // The mode is optional, to keep working the way it used to.
+    if (argc == 4 && (strcmp(argv[1], "read") == 0 || strcmp(argv[1], "write") == 0)) {
+        reading = strcmp(argv[1], "read") == 0;
+        ++argv;
+        --argc;
+    }
 
     if (argc != 3) {
-        fprintf(stderr, "Run with 2 arguments: [chunk size] [number of chunks]\n");
+        fprintf(stderr,
+                "Run with 2 or 3 arguments: [--reuse] [read|write] [chunk size] [number of chunks]\n"
+                "\n"
+                "With --reuse, buffers vmspliced into a pipe are reused once it's\n"
+                "been drained, rather than mapping fresh ones. That's faster, but\n"
+                "the reader has to copy the data out; one that splices it along\n"
+                "will see it change.\n");
         return 1;
     }
 
     chunk_size = atoi(argv[1]);
-    if (chunk_size < sizeof(int) + 2 || chunk_size > BUFF_SIZE) {
+    if (chunk_size < sizeof(int) + 2 || chunk_size > MAX_CHUNK_SIZE) {
         fprintf(stderr, "Chunk size must be between %d and %d.\n",
-                (int) sizeof(int) + 2, BUFF_SIZE);
+                (int) sizeof(int) + 2, MAX_CHUNK_SIZE);
         return 1;
     }
-    num_nums_in_chunk = (int) ((chunk_size - 2) / sizeof(int));
-    leftover_in_chunk = (chunk_size - 2) % sizeof(int);
 
-    num_chunks = atoi(argv[2]);
+    num_chunks = strtoll(argv[2], NULL, 10);
     if (num_chunks <= 0) {
         fprintf(stderr, "Number of chunks must be at least 1.\n");
         return 1;
     }
 
-    for (chunk_num=0; chunk_num < num_chunks; ++chunk_num) {
-        char chunk[BUFF_SIZE];
-        int i;
-
-        // A chunk is bookended by <>, and in the middle, as many chunk_nums
-        // as can fit, as integers, and leftover space is filled with different
-        // things every chunk (so you can see if the same chunk's repeated on
-        // partial writes).
-        chunk[0] = PICK_CHAR(prefixes, chunk_num);
-        for (i=0; i < num_nums_in_chunk; ++i) {
-            *((int*) (chunk + 1 + sizeof(int) * i)) = chunk_num;
-        }
-        for (i=1 + sizeof(int) * num_nums_in_chunk; i < chunk_size - 1; ++i) {
-            chunk[i] = PICK_CHAR(extras, chunk_num);
-        }
-        chunk[chunk_size - 1] = PICK_CHAR(suffixes, chunk_num);
-
-        fwrite(chunk, 1, chunk_size, stdout);
-    }
-
-    return 0;
+    return reading ? verify(chunk_size, num_chunks) : generate(chunk_size, num_chunks, reuse);
 }
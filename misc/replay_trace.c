@@ -0,0 +1,220 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../trace.h"
+
+#define BUFF_SIZE (64 * 1024)
+
+
+static char buff[BUFF_SIZE];
+
+
+uint64_t monotonic_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+}
+
+
+// Sleep until ns after start, returning how far behind schedule we already were.
+uint64_t wait_until(uint64_t start, uint64_t ns) {
+    struct timespec when;
+    uint64_t now = monotonic_ns();
+    uint64_t target = start + ns;
+
+    if (now >= target) {
+        return now - target;
+    }
+
+    when.tv_sec = target / (1000 * 1000 * 1000);
+    when.tv_nsec = target % (1000 * 1000 * 1000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR) {
+    }
+
+    return 0;
+}
+
+
+int produce(uint32_t bytes) {
+    while (bytes > 0) {
+        ssize_t written = write(STDOUT_FILENO, buff, bytes < BUFF_SIZE ? bytes : BUFF_SIZE);
+
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            fprintf(stderr, "Failed to write, err %d: %s\n",
+                    errno, strerror(errno));
+            return -1;
+        }
+        bytes -= written;
+    }
+
+    return 0;
+}
+
+
+int consume(uint32_t bytes) {
+    while (bytes > 0) {
+        ssize_t got = read(STDIN_FILENO, buff, bytes < BUFF_SIZE ? bytes : BUFF_SIZE);
+
+        if (got == 0) {
+            fprintf(stderr, "Ran out of input prematurely.\n");
+            return -1;
+        } else if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            fprintf(stderr, "Failed to read, err %d: %s\n",
+                    errno, strerror(errno));
+            return -1;
+        }
+        bytes -= got;
+    }
+
+    return 0;
+}
+
+
+// Write a trace of evenly spaced bursts, each read in and written out all at
+// once, so replaying it gives a bursty producer or slow consumer without
+// having to record one.
+int write_bursts(const char* path, long long num_bursts, uint32_t bytes, double ms) {
+    FILE* trace;
+    TraceRecord record;
+    long long i;
+
+    if ((trace = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "Failed to open %s, err %d: %s\n",
+                path, errno, strerror(errno));
+        return -1;
+    }
+
+    fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, trace);
+    for (i=0; i < num_bursts; ++i) {
+        record.ns = i * ms * 1000 * 1000;
+        record.bytes = bytes;
+        record.event = TraceRead;
+        fwrite(&record, sizeof(record), 1, trace);
+        record.event = TraceWrite;
+        fwrite(&record, sizeof(record), 1, trace);
+    }
+
+    if (ferror(trace) || fclose(trace) != 0) {
+        fprintf(stderr, "Failed to write %s, err %d: %s\n",
+                path, errno, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void print_usage(char** argv) {
+    fprintf(stderr,
+            "usage: %s [produce|consume] [trace file]\n"
+            "       %s bursts [trace file] [count] [bytes] [ms]\n"
+            "\n"
+            "    produce - write to stdout with the timing of the trace's reads\n"
+            "    consume - read from stdin with the timing of the trace's writes\n"
+            "    bursts  - write a trace of [count] bursts of [bytes] each, [ms]\n"
+            "              apart, instead of recording one\n",
+            argv[0], argv[0]);
+}
+
+
+int main(int argc, char** argv) {
+    FILE* trace;
+    TraceRecord record;
+    char magic[TRACE_MAGIC_SIZE];
+    uint32_t replay_event;
+    uint64_t start;
+    uint64_t behind;
+    uint64_t max_behind = 0;
+    unsigned long long num_events = 0;
+    unsigned long long total_bytes = 0;
+    int i;
+
+    if (argc == 6 && strcmp(argv[1], "bursts") == 0) {
+        long long num_bursts = strtoll(argv[3], NULL, 10);
+        long long bytes = strtoll(argv[4], NULL, 10);
+        double ms = strtod(argv[5], NULL);
+
+        if (num_bursts <= 0 || bytes <= 0 || bytes > UINT32_MAX || ms < 0) {
+            print_usage(argv);
+            return -1;
+        }
+        return write_bursts(argv[2], num_bursts, (uint32_t) bytes, ms);
+    }
+
+    if (argc != 3) {
+        print_usage(argv);
+        return -1;
+    }
+
+    if (strcmp(argv[1], "produce") == 0) {
+        replay_event = TraceRead;
+    } else if (strcmp(argv[1], "consume") == 0) {
+        replay_event = TraceWrite;
+    } else {
+        print_usage(argv);
+        return -1;
+    }
+
+    if ((trace = fopen(argv[2], "rb")) == NULL) {
+        fprintf(stderr, "Failed to open %s, err %d: %s\n",
+                argv[2], errno, strerror(errno));
+        return -1;
+    }
+
+    if (fread(magic, 1, TRACE_MAGIC_SIZE, trace) != TRACE_MAGIC_SIZE ||
+            memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "%s isn't a pipestats trace.\n", argv[2]);
+        return -1;
+    }
+
+    // Produce something more interesting than all zeros.
+    for (i=0; i < BUFF_SIZE; ++i) {
+        buff[i] = (char) i;
+    }
+
+    start = monotonic_ns();
+    while (fread(&record, sizeof(record), 1, trace) == 1) {
+        int err;
+
+        // Stalls are just the gaps between the other events, so replaying
+        // the timing of reads or writes replays them too.
+        if (record.event != replay_event) {
+            continue;
+        }
+
+        behind = wait_until(start, record.ns);
+        if (behind > max_behind) {
+            max_behind = behind;
+        }
+
+        err = replay_event == TraceRead ? produce(record.bytes) : consume(record.bytes);
+        if (err != 0) {
+            return err;
+        }
+
+        ++num_events;
+        total_bytes += record.bytes;
+    }
+
+    fprintf(stderr,
+            "Replayed %llu events, %llu bytes over %.2f sec, "
+            "at most %.2f ms behind schedule.\n",
+            num_events, total_bytes,
+            (monotonic_ns() - start) / (1000.0 * 1000 * 1000),
+            max_behind / (1000.0 * 1000));
+
+    return 0;
+}
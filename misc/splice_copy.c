@@ -0,0 +1,137 @@
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+
+#define BUFF_SIZE (64 * 1024)
+
+
+static volatile sig_atomic_t done = 0;
+
+
+void stop(int signal) {
+    done = 1;
+}
+
+
+// Splice everything from stdin to stdout, returning -1 if it can't be spliced
+// at all, and otherwise 0 or 1 for success or failure.
+int splice_all(unsigned long long* total) {
+    int pipe_fds[2];
+    int in_fd = STDIN_FILENO;
+    int out_fd = STDOUT_FILENO;
+    int direct;
+
+    direct = fcntl(in_fd, F_GETPIPE_SZ) > 0 || fcntl(out_fd, F_GETPIPE_SZ) > 0;
+    if (!direct && pipe(pipe_fds) != 0) {
+        fprintf(stderr, "Failed to create a pipe, err %d: %s\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    while (!done) {
+        ssize_t n;
+        ssize_t left;
+
+        if (direct) {
+            n = splice(in_fd, NULL, out_fd, NULL, BUFF_SIZE, SPLICE_F_MOVE);
+        } else if ((n = splice(in_fd, NULL, pipe_fds[1], NULL, BUFF_SIZE, SPLICE_F_MOVE)) > 0) {
+            // Once data's in our pipe, there's no falling back to copying.
+            for (left = n; left > 0; left -= n) {
+                while ((n = splice(pipe_fds[0], NULL, out_fd, NULL, left, SPLICE_F_MOVE)) < 0 &&
+                       errno == EINTR) {
+                }
+                if (n <= 0) {
+                    fprintf(stderr, "Failed to splice %zd bytes out, err %d: %s\n",
+                            left, errno, strerror(errno));
+                    return 1;
+                }
+                *total += n;
+            }
+            continue;
+        }
+
+        if (n > 0) {
+            *total += n;
+        } else if (n == 0) {
+            break;
+        } else if (errno == EINVAL && *total == 0) {
+            return -1;
+        } else if (errno != EINTR && errno != EAGAIN) {
+            fprintf(stderr, "Failed to splice, err %d: %s\n",
+                    errno, strerror(errno));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+// Copy stdin to stdout with read & write.
+int copy_all(unsigned long long* total) {
+    static char buff[BUFF_SIZE];
+
+    while (!done) {
+        ssize_t n = read(STDIN_FILENO, buff, BUFF_SIZE);
+        ssize_t written;
+
+        if (n == 0) {
+            break;
+        } else if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            fprintf(stderr, "Failed to read, err %d: %s\n",
+                    errno, strerror(errno));
+            return 1;
+        }
+
+        for (written = 0; written < n; ) {
+            ssize_t w = write(STDOUT_FILENO, buff + written, n - written);
+
+            if (w < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                fprintf(stderr, "Failed to write, err %d: %s\n",
+                        errno, strerror(errno));
+                return 1;
+            }
+            written += w;
+        }
+        *total += n;
+    }
+
+    return 0;
+}
+
+
+// Copy stdin to stdout the fastest way the kernel offers, as a baseline for
+// what pipestats could be doing. Splices through a pipe of our own when
+// neither end is a pipe already, and falls back to read & write if the input
+// can't be spliced at all.
+int main(int argc, char** argv) {
+    struct sigaction stop_action;
+    unsigned long long total = 0;
+    int err;
+
+    // Stop cleanly when interrupted, to still report how much was copied.
+    memset(&stop_action, 0, sizeof(struct sigaction));
+    stop_action.sa_handler = &stop;
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+
+    if ((err = splice_all(&total)) == -1) {
+        err = copy_all(&total);
+    }
+
+    fprintf(stderr, "%llu bytes\n", total);
+
+    return err;
+}
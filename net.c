@@ -0,0 +1,158 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "net.h"
+
+
+#define LISTEN_BACKLOG (16)
+
+
+int listen_on(const char* port) {
+    struct addrinfo hints;
+    struct addrinfo* addrs;
+    struct addrinfo* addr;
+    int fd = -1;
+    int err;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if ((err = getaddrinfo(NULL, port, &hints, &addrs)) != 0) {
+        fprintf(stderr, "Failed to look up port %s: %s\n",
+                port, gai_strerror(err));
+        return -1;
+    }
+
+    err = 0;
+    for (addr=addrs; addr != NULL; addr = addr->ai_next) {
+        int reuse = 1;
+
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd == -1) {
+            err = errno;
+            continue;
+        }
+
+        // So a quick restart doesn't have to wait out TIME_WAIT.
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(fd, addr->ai_addr, addr->ai_addrlen) == 0 &&
+                listen(fd, LISTEN_BACKLOG) == 0) {
+            break;
+        }
+
+        err = errno;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+
+    if (fd == -1) {
+        fprintf(stderr, "Failed to listen on port %s, err %d: %s\n",
+                port, err, strerror(err));
+    }
+
+    return fd;
+}
+
+
+int accept_from(int listen_fd, char* peer, size_t peer_len) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+    int fd;
+
+    fd = accept(listen_fd, (struct sockaddr*) &addr, &addr_len);
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (peer && peer_len > 0) {
+        if (getnameinfo((struct sockaddr*) &addr, addr_len,
+                        host, sizeof(host), serv, sizeof(serv),
+                        NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+            snprintf(peer, peer_len, "%s:%s", host, serv);
+        } else {
+            snprintf(peer, peer_len, "unknown peer");
+        }
+    }
+
+    return fd;
+}
+
+
+int connect_to(const char* host_port) {
+    struct addrinfo hints;
+    struct addrinfo* addrs;
+    struct addrinfo* addr;
+    char host[NI_MAXHOST];
+    const char* port;
+    const char* colon;
+    size_t host_len;
+    int fd = -1;
+    int err;
+
+    // Split on the last colon, so bracketed IPv6 addresses work too.
+    colon = strrchr(host_port, ':');
+    if (!colon || colon == host_port || colon[1] == '\0') {
+        fprintf(stderr, "Expected HOST:PORT, got \"%s\"\n", host_port);
+        return -1;
+    }
+    port = colon + 1;
+
+    host_len = colon - host_port;
+    if (host_port[0] == '[' && host_len > 2 && host_port[host_len - 1] == ']') {
+        ++host_port;
+        host_len -= 2;
+    }
+    if (host_len >= sizeof(host)) {
+        fprintf(stderr, "Host name too long in \"%s\"\n", host_port);
+        return -1;
+    }
+    memcpy(host, host_port, host_len);
+    host[host_len] = '\0';
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ((err = getaddrinfo(host, port, &hints, &addrs)) != 0) {
+        fprintf(stderr, "Failed to look up %s port %s: %s\n",
+                host, port, gai_strerror(err));
+        return -1;
+    }
+
+    err = 0;
+    for (addr=addrs; addr != NULL; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd == -1) {
+            err = errno;
+            continue;
+        }
+
+        if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+            break;
+        }
+
+        err = errno;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+
+    if (fd == -1) {
+        fprintf(stderr, "Failed to connect to %s port %s, err %d: %s\n",
+                host, port, err, strerror(err));
+    }
+
+    return fd;
+}
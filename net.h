@@ -0,0 +1,13 @@
+
+#ifndef __NET_H__
+#define __NET_H__
+
+#include <stddef.h>
+
+int listen_on(const char* port);
+
+int accept_from(int listen_fd, char* peer, size_t peer_len);
+
+int connect_to(const char* host_port);
+
+#endif
@@ -1,4 +1,6 @@
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -16,19 +18,37 @@
 
 #include "units.h"
 #include "time_estimate.h"
+#include "net.h"
+#include "latency.h"
+#include "trace.h"
+#include "drift.h"
 
 
 #define BUF_SIZE (4092)
 
+// Relaying moves up to a default pipe's worth of data at a time.
+#define RELAY_BUF_SIZE (64 * 1024)
+
 
 typedef struct Stats {
     unsigned long int total_bytes;
-    unsigned int bytes_since;
+    unsigned long int bytes_since;
 
     struct timeval last_report;
     struct timeval start;
 
     unsigned long long byte_count[256];
+
+    // Bytes read but not yet written, and when the oldest of them was read.
+    unsigned long int bytes_buffered;
+    unsigned long long buffered_since_ns;
+
+    // How long blocks sat in the buffer, since last report and overall.
+    LatencyHist latency_since;
+    LatencyHist latency_total;
+
+    // Sampled byte distribution per report interval, to spot changes.
+    Drift drift;
 } Stats;
 
 
@@ -37,6 +57,12 @@ typedef struct Options {
     Unit unit;
     int blocking;
     int counts;
+    int latency;
+    int drift;
+    double drift_threshold;
+    const char* trace_path;
+    const char* listen_port;
+    const char* connect_addr;
 } Options;
 Options options;
 
@@ -49,10 +75,21 @@ double elapsed_sec(struct timeval* end, struct timeval* start);
 
 int read_options();
 int setup(Stats* stats, struct timeval* report_interval);
+struct timeval* wait_timeout(struct timeval* timeout, struct timeval* report_interval);
 
 
 void check_read_errors();
 int check_write_errors();
+int transient_error(int err);
+
+
+void count_read(Stats* stats, const char* buff, int bytes_read);
+void count_written(Stats* stats, int bytes_written);
+
+
+int relay(Stats* stats, struct timeval* report_interval);
+int forward(int in_fd, int out_fd, Stats* stats, struct timeval* report_interval,
+            int* out_failed);
 
 
 void print_report(Stats* stats);
@@ -80,19 +117,34 @@ int main(int argc, char** argv) {
         return err;
     }
 
+    if (options.listen_port || options.connect_addr) {
+        err = relay(&stats, &report_interval);
+        if (trace_close() != 0 && err == 0) {
+            err = -1;
+        }
+        print_final_report(&stats);
+        return err;
+    }
+
     while (bytes_read > 0 || !done) {
         print_report(&stats);
 
         // Only read more if we've already written everything we already had.
         if (bytes_read == 0) {
+            struct timeval timeout;
             fd_set set;
+            int ready;
 
             // Use select so we don't wait for longer than report interval, but
             // we do wait for some input at least that long (as opposed to just
             // plain non-blocking io).
             FD_ZERO(&set);
             FD_SET(STDIN_FILENO, &set);
-            if (select(FD_SETSIZE, &set, NULL, NULL, &report_interval) > 0) {
+            ready = select(FD_SETSIZE, &set, NULL, NULL,
+                           wait_timeout(&timeout, &report_interval));
+            if (ready == 0) {
+                trace_record(TraceReadStall, 0);
+            } else if (ready > 0) {
                 bytes_read = fread(buff, 1, BUF_SIZE, stdin);
 
                 if (bytes_read == 0 && ferror(stdin) != 0) {
@@ -112,30 +164,30 @@ int main(int argc, char** argv) {
                         err = errno;
                         break;
                     }
-                } else {
-                    int i;
-
-                    stats.total_bytes += bytes_read;
-                    stats.bytes_since += bytes_read;
-
-                    if (options.counts) {
-                        for (i=0; i < bytes_read; ++i) {
-                            ++stats.byte_count[(int) ((unsigned char) buff[i])];
-                        }
-                    }
+                } else if (bytes_read > 0) {
+                    count_read(&stats, buff, bytes_read);
                 }
             }
         }
 
         if (bytes_read > 0) {
+            struct timeval timeout;
             fd_set set;
+            int ready;
 
             FD_ZERO(&set);
             FD_SET(STDOUT_FILENO, &set);
-            if (select(FD_SETSIZE, NULL, &set, NULL, &report_interval) > 0) {
-                int bytes_written = fwrite(buff + buff_offset, 1, bytes_read, stdout);
-
-                if (bytes_written == 0 && ferror(stdout) != 0) {
+            ready = select(FD_SETSIZE, NULL, &set, NULL,
+                           wait_timeout(&timeout, &report_interval));
+            if (ready == 0) {
+                trace_record(TraceWriteStall, bytes_read);
+            } else if (ready > 0) {
+                // Write straight to the fd rather than through stdio, which
+                // can lose buffered data when a nonblocking write comes up
+                // short.
+                int bytes_written = write(STDOUT_FILENO, buff + buff_offset, bytes_read);
+
+                if (bytes_written < 0) {
                     switch (errno) {
                     case EINTR:
                     case EBUSY:
@@ -151,12 +203,17 @@ int main(int argc, char** argv) {
                                 "Exiting with %d bytes still in buffer.\n",
                                 errno, strerror(errno), bytes_read);
                         bytes_read = 0;
+                        stats.bytes_buffered = 0;
                         done = 1;
                         err = errno;
                         break;
                     }
                 }
 
+                if (bytes_written > 0) {
+                    count_written(&stats, bytes_written);
+                }
+
                 if (bytes_written == bytes_read) {
                     bytes_read = 0;
                     buff_offset = 0;
@@ -168,33 +225,11 @@ int main(int argc, char** argv) {
         } else {
             // Make sure not to clear a done flag from some other reason.
             done = done || feof(stdin);
-
-            // Good time to proactively ask for a flush, cuz maybe there isn't
-            // much happening (since we haven't read anything). But don't
-            // bother trying multiple times if it fails, it's just kinda a
-            // nice time.
-            fflush(stdout);
         }
     }
 
-    // Just for timing niceness, flush buffers before printing report.
-    done = 0;
-    while (!done && fflush(stdout) != 0) {
-        switch (errno) {
-        case EINTR:
-        case EBUSY:
-        case EDEADLK:
-        case EAGAIN:
-        case ETXTBSY:
-            break;
-
-        default:
-            fprintf(stderr, "Failed to flush stdout, err %d: %s\n",
-                    errno, strerror(errno));
-            err = errno;
-            done = 1;
-            break;
-        }
+    if (trace_close() != 0 && err == 0) {
+        err = -1;
     }
 
     print_final_report(&stats);
@@ -211,6 +246,11 @@ int read_options(int argc, char** argv) {
         {"freq", required_argument, NULL, 'f'},
         {"blocking-io", no_argument, NULL, 'b'},
         {"counts", no_argument, NULL, 'c'},
+        {"latency", no_argument, NULL, 'l'},
+        {"drift", optional_argument, NULL, 'd'},
+        {"trace", required_argument, NULL, 't'},
+        {"listen", required_argument, NULL, 'L'},
+        {"connect", required_argument, NULL, 'C'},
         {0, 0, 0, 0}
     };
 
@@ -218,11 +258,12 @@ int read_options(int argc, char** argv) {
     options.freq = 2.0;
     options.unit = Human;
     options.blocking = 0;
+    options.drift_threshold = DRIFT_DEFAULT_THRESHOLD;
 
     while (opt != -1) {
         int option_index = 0;
 
-        opt = getopt_long(argc, argv, "hHBKMGf:bc", long_options, &option_index);
+        opt = getopt_long(argc, argv, "hHBKMGf:bcld::t:L:C:", long_options, &option_index);
         switch (opt) {
         case -1:
             break;
@@ -235,10 +276,21 @@ int read_options(int argc, char** argv) {
                    "    -[B|K|M|G]           Use Bytes, Kilobytes, Megabytes, or Gigabytes.\n"
                    "    -b/--blocking-io     Use blocking io.\n"
                    "    -c/--counts          Report count per byte value at the end.\n"
+                   "    -l/--latency         Report how long data sits in pipestats' buffer.\n"
+                   "    -d/--drift[=SCORE]   Report when the mix of byte values changes, by\n"
+                   "                         at least SCORE bits of divergence (default %.2f).\n"
+                   "    -t/--trace FILE      Record timing of every read, write & stall to FILE.\n"
+                   "    -L/--listen PORT     Read from connections to PORT instead of stdin.\n"
+                   "    -C/--connect HOST:PORT\n"
+                   "                         Write to a connection to HOST:PORT instead of stdout.\n"
                    "\n"
                    "pipestats reads from stdin, writes that input to stdout, "
-                   "and reports stats about data transfered to stderr.\n",
-                   argv[0]);
+                   "and reports stats about data transfered to stderr.\n"
+                   "\n"
+                   "With --listen and/or --connect it relays between sockets, "
+                   "accepting one connection after another, and opening a new "
+                   "outgoing connection for each.\n",
+                   argv[0], DRIFT_DEFAULT_THRESHOLD);
             return -1;
             break;
 
@@ -246,6 +298,25 @@ int read_options(int argc, char** argv) {
             options.counts = 1;
             break;
 
+        case 'l':
+            options.latency = 1;
+            break;
+
+        case 'd':
+            options.drift = 1;
+            if (optarg) {
+                options.drift_threshold = strtod(optarg, NULL);
+                if (options.drift_threshold <= 0 || options.drift_threshold > 1) {
+                    fprintf(stderr, "ERROR: drift score must be > 0 and <= 1\n");
+                    return -1;
+                }
+            }
+            break;
+
+        case 't':
+            options.trace_path = optarg;
+            break;
+
         case 'H':
             options.unit = Human;
             break;
@@ -278,6 +349,14 @@ int read_options(int argc, char** argv) {
             options.blocking = 1;
             break;
 
+        case 'L':
+            options.listen_port = optarg;
+            break;
+
+        case 'C':
+            options.connect_addr = optarg;
+            break;
+
         case '?':
             return -1;
             break;
@@ -295,7 +374,7 @@ int read_options(int argc, char** argv) {
 int setup(Stats* stats, struct timeval* report_interval) {
     struct sigaction cleanup_action;
     double half_freq;
-    int abort_signals[] = {SIGHUP, SIGINT, SIGQUIT, SIGABRT, SIGPIPE, SIGTERM};
+    int abort_signals[] = {SIGHUP, SIGINT, SIGQUIT, SIGABRT, SIGTERM};
     int i;
     int err;
 
@@ -325,6 +404,10 @@ int setup(Stats* stats, struct timeval* report_interval) {
         clearerr(stdout);
     }
 
+    if (options.trace_path && trace_open(options.trace_path) != 0) {
+        return -1;
+    }
+
     // Timing for report.
     half_freq = options.freq / 2.0;
     report_interval->tv_sec = (int) half_freq;
@@ -350,10 +433,353 @@ int setup(Stats* stats, struct timeval* report_interval) {
         }
     }
 
+    // No need for handling a broken pipe, writes will fail with EPIPE and the
+    // app will show a message and/or abort if it's relevant. Ignoring it for
+    // good, rather than once, lets the final report still happen, and in
+    // relay mode a consumer going away only ends its own connection.
+    signal(SIGPIPE, SIG_IGN);
+
     return 0;
 }
 
 
+int transient_error(int err) {
+    switch (err) {
+    case EINTR:
+    case EBUSY:
+    case EDEADLK:
+    case EAGAIN:
+    case ETXTBSY:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+
+// Timeout for a select waiting on io: the report interval, or none at all when
+// there are no periodic reports, since a signal interrupts it either way. When
+// tracing, it's no longer than a stall, so stalls get recorded regardless.
+// Select can change the timeout, so it's a copy in the given struct.
+struct timeval* wait_timeout(struct timeval* timeout, struct timeval* report_interval) {
+    struct timeval stall = {0, TRACE_STALL_MS * 1000};
+
+    if (options.trace_path &&
+            (options.freq <= 0 || timercmp(report_interval, &stall, >))) {
+        *timeout = stall;
+        return timeout;
+    }
+
+    if (options.freq <= 0) {
+        return NULL;
+    }
+
+    *timeout = *report_interval;
+    return timeout;
+}
+
+
+void count_read(Stats* stats, const char* buff, int bytes_read) {
+    int i;
+
+    if (options.latency && stats->bytes_buffered == 0) {
+        stats->buffered_since_ns = monotonic_ns();
+    }
+
+    stats->total_bytes += bytes_read;
+    stats->bytes_since += bytes_read;
+    stats->bytes_buffered += bytes_read;
+
+    trace_record(TraceRead, bytes_read);
+
+    // Spliced data never passes through a buffer, so it can't be counted.
+    if (options.counts && buff) {
+        for (i=0; i < bytes_read; ++i) {
+            ++stats->byte_count[(int) ((unsigned char) buff[i])];
+        }
+    }
+
+    if (options.drift && buff) {
+        drift_sample(&stats->drift, buff, bytes_read);
+
+        // With no reports to end intervals, end them as soon as they're big
+        // enough to score.
+        if (options.freq <= 0 && stats->drift.samples >= DRIFT_MIN_SAMPLES) {
+            drift_check(&stats->drift, stats->total_bytes,
+                        options.drift_threshold, DRIFT_MIN_SAMPLES);
+        }
+    }
+}
+
+
+void count_written(Stats* stats, int bytes_written) {
+    stats->bytes_buffered -= bytes_written;
+
+    trace_record(TraceWrite, bytes_written);
+
+    // Residence time is per block: from when it was read until the last of
+    // it is written.
+    if (options.latency && stats->bytes_buffered == 0) {
+        unsigned long long residence = monotonic_ns() - stats->buffered_since_ns;
+
+        latency_record(&stats->latency_since, residence);
+        latency_record(&stats->latency_total, residence);
+    }
+}
+
+
+int relay(Stats* stats, struct timeval* report_interval) {
+    int listen_fd = -1;
+    int err = 0;
+
+    if (options.listen_port) {
+        if ((listen_fd = listen_on(options.listen_port)) == -1) {
+            return -1;
+        }
+        fprintf(stderr, "Listening on port %s.\n", options.listen_port);
+
+        // A connection can go away between select saying it's there and
+        // accepting it, and accept shouldn't block on the next one then.
+        if (fcntl(listen_fd, F_SETFL, O_NONBLOCK) == -1) {
+            fprintf(stderr,
+                    "Warning: failed to put listening socket in nonblocking mode. "
+                    "Reporting might not be consistently on time.\n");
+        }
+    }
+
+    while (!done) {
+        int in_fd = STDIN_FILENO;
+        int out_fd = STDOUT_FILENO;
+        unsigned long int conn_start;
+        int conn_err;
+        int out_failed = 0;
+        char peer[128];
+
+        if (listen_fd != -1) {
+            struct timeval timeout;
+            fd_set set;
+
+            print_report(stats);
+
+            // Wait for a connection no longer than the report interval, so
+            // reports keep coming and signals get noticed while idle.
+            FD_ZERO(&set);
+            FD_SET(listen_fd, &set);
+            if (select(listen_fd + 1, &set, NULL, NULL,
+                       wait_timeout(&timeout, report_interval)) <= 0) {
+                continue;
+            }
+
+            if ((in_fd = accept_from(listen_fd, peer, sizeof(peer))) == -1) {
+                if (!transient_error(errno) && errno != ECONNABORTED) {
+                    fprintf(stderr, "Failed to accept a connection, err %d: %s\n",
+                            errno, strerror(errno));
+                    err = errno;
+                    break;
+                }
+                continue;
+            }
+            fprintf(stderr, "Accepted connection from %s.\n", peer);
+
+            if (!options.blocking && fcntl(in_fd, F_SETFL, O_NONBLOCK) == -1) {
+                fprintf(stderr,
+                        "Warning: failed to put connection in nonblocking mode. "
+                        "Reporting might not be consistently on time.\n");
+            }
+        }
+
+        if (options.connect_addr) {
+            if ((out_fd = connect_to(options.connect_addr)) == -1) {
+                if (listen_fd == -1) {
+                    err = -1;
+                    break;
+                }
+
+                // Drop this connection, but keep waiting for the next one.
+                fprintf(stderr, "Dropping connection from %s.\n", peer);
+                close(in_fd);
+                continue;
+            }
+
+            if (!options.blocking && fcntl(out_fd, F_SETFL, O_NONBLOCK) == -1) {
+                fprintf(stderr,
+                        "Warning: failed to put connection in nonblocking mode. "
+                        "Reporting might not be consistently on time.\n");
+            }
+        }
+
+        conn_start = stats->total_bytes;
+        conn_err = forward(in_fd, out_fd, stats, report_interval, &out_failed);
+
+        if (options.connect_addr) {
+            close(out_fd);
+        }
+
+        if (listen_fd == -1) {
+            // There's only the one stdin stream to relay.
+            err = conn_err;
+            break;
+        }
+
+        fprintf(stderr, "Connection from %s closed after %lu bytes.\n",
+                peer, stats->total_bytes - conn_start);
+        close(in_fd);
+
+        // Every connection shares stdout, so once it's broken there's nowhere
+        // for the next one to go. A connection of their own failing only
+        // drops that one.
+        if (out_failed && out_fd == STDOUT_FILENO) {
+            err = conn_err;
+            break;
+        }
+    }
+
+    if (listen_fd != -1) {
+        close(listen_fd);
+    }
+
+    return err;
+}
+
+
+int forward(int in_fd, int out_fd, Stats* stats, struct timeval* report_interval,
+            int* out_failed) {
+    static char buff[RELAY_BUF_SIZE];
+    int pipe_fds[2] = {-1, -1};
+    int use_splice = !options.counts && !options.drift;
+    int eof = 0;
+    int err = 0;
+    ssize_t buffered = 0;
+    size_t buff_offset = 0;
+
+    // Data is spliced from in_fd into a pipe, and from the pipe into out_fd,
+    // so it never gets copied into userspace. Counting bytes or watching for
+    // drift needs to see the data, so that copies through buff instead.
+    if (use_splice && pipe(pipe_fds) != 0) {
+        fprintf(stderr,
+                "Warning: failed to create a pipe, err %d: %s\n"
+                "Copying data instead of splicing.\n",
+                errno, strerror(errno));
+        use_splice = 0;
+    }
+
+    while (buffered > 0 || (!eof && !done)) {
+        struct timeval timeout;
+        fd_set set;
+        ssize_t n;
+
+        print_report(stats);
+
+        // Only read more if we've already written everything we already had.
+        if (buffered == 0) {
+            FD_ZERO(&set);
+            FD_SET(in_fd, &set);
+            n = select(in_fd + 1, &set, NULL, NULL,
+                       wait_timeout(&timeout, report_interval));
+            if (n <= 0) {
+                if (n == 0) {
+                    trace_record(TraceReadStall, 0);
+                }
+                continue;
+            }
+
+            if (use_splice) {
+                n = splice(in_fd, NULL, pipe_fds[1], NULL, RELAY_BUF_SIZE,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n == -1 && errno == EINVAL) {
+                    // Input can't be spliced from (a tty, say), so copy.
+                    use_splice = 0;
+                    continue;
+                }
+            } else {
+                n = read(in_fd, buff, RELAY_BUF_SIZE);
+            }
+
+            if (n == 0) {
+                eof = 1;
+            } else if (n < 0) {
+                if (!transient_error(errno)) {
+                    fprintf(stderr, "Got err %d during a read: %s\n",
+                            errno, strerror(errno));
+                    err = errno;
+                    eof = 1;
+                }
+            } else {
+                buffered = n;
+                buff_offset = 0;
+                count_read(stats, use_splice ? NULL : buff, n);
+            }
+        }
+
+        if (buffered > 0) {
+            FD_ZERO(&set);
+            FD_SET(out_fd, &set);
+            n = select(out_fd + 1, NULL, &set, NULL,
+                       wait_timeout(&timeout, report_interval));
+            if (n <= 0) {
+                if (n == 0) {
+                    trace_record(TraceWriteStall, buffered);
+                }
+                continue;
+            }
+
+            if (use_splice) {
+                n = splice(pipe_fds[0], NULL, out_fd, NULL, buffered,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n == -1 && errno == EINVAL) {
+                    // Output can't be spliced to (opened for append, say), so
+                    // take back what's in the pipe and copy from now on.
+                    n = read(pipe_fds[0], buff, buffered);
+                    if (n != buffered) {
+                        fprintf(stderr,
+                                "Failed to recover %zd bytes from pipe.\n",
+                                buffered);
+                        err = -1;
+                        *out_failed = 1;
+                        buffered = 0;
+                        stats->bytes_buffered = 0;
+                        eof = 1;
+                        continue;
+                    }
+                    use_splice = 0;
+                    buff_offset = 0;
+                    continue;
+                }
+            } else {
+                n = write(out_fd, buff + buff_offset, buffered);
+            }
+
+            if (n < 0) {
+                if (!transient_error(errno)) {
+                    // Can't write, so there's no point in continuing.
+                    fprintf(stderr,
+                            "Got err %d during a write: %s\n"
+                            "Dropping %zd bytes still in buffer.\n",
+                            errno, strerror(errno), buffered);
+                    err = errno;
+                    *out_failed = 1;
+                    buffered = 0;
+                    stats->bytes_buffered = 0;
+                    eof = 1;
+                }
+            } else {
+                buffered -= n;
+                buff_offset += n;
+                count_written(stats, n);
+            }
+        }
+    }
+
+    if (pipe_fds[0] != -1) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+
+    return err;
+}
+
+
 double elapsed_sec(struct timeval* end, struct timeval* start) {
     double sec = end->tv_sec - start->tv_sec;
     double usec = end->tv_usec - start->tv_usec;
@@ -406,6 +832,36 @@ void print_report(Stats* stats) {
                 time.time_remaining, time.time_unit,
                 milestone_amount, milestone_amount_unit);
 
+        if (options.latency) {
+            LatencyHist* hist = &stats->latency_since;
+            double p50 = latency_percentile(hist, 50);
+            double p99 = latency_percentile(hist, 99);
+            double max = hist->max_ns;
+
+            fprintf(stderr,
+                    "    latency p50 %.2f %s, p99 %.2f %s, max %.2f %s"
+                    ", %lu bytes buffered\n",
+                    adjust_latency(p50), latency_unit(p50),
+                    adjust_latency(p99), latency_unit(p99),
+                    adjust_latency(max), latency_unit(max),
+                    stats->bytes_buffered);
+
+            latency_reset(hist);
+        }
+
+        if (options.drift &&
+                drift_check(&stats->drift, stats->total_bytes,
+                            options.drift_threshold, DRIFT_MIN_SAMPLES)) {
+            fprintf(stderr,
+                    "    byte distribution changed (drift %.3f)"
+                    " between bytes %lu and %lu\n",
+                    stats->drift.score,
+                    stats->drift.last_change_start,
+                    stats->drift.last_change_end);
+        } else if (options.drift && stats->drift.score >= 0) {
+            fprintf(stderr, "    drift %.3f\n", stats->drift.score);
+        }
+
         stats->bytes_since = 0;
         stats->last_report = now;
     }
@@ -440,6 +896,50 @@ void print_final_report(Stats* stats) {
         }
     }
 
+    // Whatever's left since the last report is an interval too.
+    if (options.drift) {
+        drift_check(&stats->drift, stats->total_bytes,
+                    options.drift_threshold, DRIFT_FINAL_MIN_SAMPLES);
+    }
+
+    if (options.drift && stats->drift.num_changes > 0) {
+        unsigned long long num_listed = stats->drift.num_changes;
+
+        if (num_listed > DRIFT_MAX_CHANGES) {
+            num_listed = DRIFT_MAX_CHANGES;
+        }
+
+        fprintf(stderr, "Byte distribution changed %llu times, between bytes:\n",
+                stats->drift.num_changes);
+        for (i=0; i < num_listed; ++i) {
+            fprintf(stderr, "    %lu - %lu\n",
+                    stats->drift.change_starts[i], stats->drift.change_ends[i]);
+        }
+        if (num_listed < stats->drift.num_changes) {
+            fprintf(stderr, "    ...\n    %lu - %lu\n",
+                    stats->drift.last_change_start, stats->drift.last_change_end);
+        }
+    }
+
+    if (options.latency) {
+        LatencyHist* hist = &stats->latency_total;
+        double p50 = latency_percentile(hist, 50);
+        double p90 = latency_percentile(hist, 90);
+        double p99 = latency_percentile(hist, 99);
+        double p999 = latency_percentile(hist, 99.9);
+        double max = hist->max_ns;
+
+        fprintf(stderr,
+                "Latency over %llu blocks: p50 %.2f %s, p90 %.2f %s"
+                ", p99 %.2f %s, p99.9 %.2f %s, max %.2f %s\n",
+                hist->count,
+                adjust_latency(p50), latency_unit(p50),
+                adjust_latency(p90), latency_unit(p90),
+                adjust_latency(p99), latency_unit(p99),
+                adjust_latency(p999), latency_unit(p999),
+                adjust_latency(max), latency_unit(max));
+    }
+
     fprintf(stderr, "%3.2f %s (%lu bytes) total over %.2f sec, avg %.2f %s/s\n",
             data_amount, data_amount_unit,
             stats->total_bytes,
@@ -450,12 +950,8 @@ void print_final_report(Stats* stats) {
 
 
 void cleanup(int signal) {
-    // No need for handling a broken pipe, the app will show a message and/or
-    // abort if it's relevant.
-    if (signal != SIGPIPE) {
-        fprintf(stderr, "\nGot signal %s, aborting early.\n",
-                strsignal(signal));
+    fprintf(stderr, "\nGot signal %s, aborting early.\n",
+            strsignal(signal));
 
-        done = 1;
-    }
+    done = 1;
 }
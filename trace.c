@@ -0,0 +1,83 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+#include "latency.h"
+
+
+#define TRACE_BUF_SIZE (64 * 1024)
+
+
+static FILE* trace_file = NULL;
+static unsigned long long trace_start_ns;
+static TraceEvent last_event = 0;
+// First error writing the trace, kept for trace_close to report, since the
+// write it happened in isn't the one that gets checked.
+static int trace_err = 0;
+static char trace_buff[TRACE_BUF_SIZE];
+
+
+int trace_open(const char* path) {
+    if ((trace_file = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "Failed to open trace file %s, err %d: %s\n",
+                path, errno, strerror(errno));
+        return -1;
+    }
+
+    // Records are small and frequent, so only hit the disk in big chunks.
+    setvbuf(trace_file, trace_buff, _IOFBF, TRACE_BUF_SIZE);
+
+    if (fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, trace_file) != TRACE_MAGIC_SIZE) {
+        trace_err = errno;
+    }
+    trace_start_ns = monotonic_ns();
+
+    return 0;
+}
+
+
+void trace_record(TraceEvent event, unsigned long bytes) {
+    TraceRecord record;
+
+    if (!trace_file) {
+        return;
+    }
+
+    // A stall lasts until the next read or write, so only record its start.
+    if ((event == TraceReadStall || event == TraceWriteStall) &&
+            event == last_event) {
+        return;
+    }
+    last_event = event;
+
+    record.ns = monotonic_ns() - trace_start_ns;
+    record.bytes = bytes;
+    record.event = event;
+
+    if (fwrite(&record, sizeof(record), 1, trace_file) != 1 && !trace_err) {
+        trace_err = errno;
+    }
+}
+
+
+int trace_close() {
+    int err = 0;
+
+    if (!trace_file) {
+        return 0;
+    }
+
+    if (fclose(trace_file) != 0 && !trace_err) {
+        trace_err = errno;
+    }
+    if (trace_err) {
+        err = trace_err;
+        fprintf(stderr, "Failed to write trace file, err %d: %s\n",
+                err, strerror(err));
+    }
+    trace_file = NULL;
+
+    return err;
+}
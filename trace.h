@@ -0,0 +1,37 @@
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+// A trace file is TRACE_MAGIC followed by TraceRecords, in native byte order.
+#define TRACE_MAGIC "PSTRACE1"
+#define TRACE_MAGIC_SIZE (8)
+
+// Waiting this long with nothing to read or write is a stall, or less if
+// reports are more often than that.
+#define TRACE_STALL_MS (100)
+
+typedef enum TraceEvent {
+    TraceRead = 1,
+    TraceWrite = 2,
+    TraceReadStall = 3,
+    TraceWriteStall = 4,
+} TraceEvent;
+
+typedef struct TraceRecord {
+    // Monotonic time since the trace started.
+    uint64_t ns;
+    // Bytes moved, or for a stall, bytes waiting in the buffer. A stall is
+    // only recorded once, until the next read or write.
+    uint32_t bytes;
+    uint32_t event;
+} TraceRecord;
+
+int trace_open(const char* path);
+
+void trace_record(TraceEvent event, unsigned long bytes);
+
+int trace_close();
+
+#endif